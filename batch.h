@@ -0,0 +1,131 @@
+#pragma once
+
+#include "loader.h"
+#include "run.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+const int max_batch_size = 8;
+
+template <int N>
+std::string evaluate_program(ProgramText const& program, unsigned int max_steps)
+{
+    if (program.size != N || !program.square()) {
+        return evaluate_program<N-1>(program, max_steps);
+    }
+    // a Run is expensive to construct, so every thread keeps one per size
+    static thread_local Run<N> r;
+    Field<N> f = to_field<N>(program);
+    r.reset(f);
+    typename Run<N>::Result result = r.execute(max_steps);
+    std::ostringstream os;
+    os << N << "x" << N << " " << Run<N>::result_type_name(result.type) << " after " << result.steps << " steps";
+    return os.str();
+}
+
+template <>
+inline std::string evaluate_program<0>(ProgramText const& program, unsigned int)
+{
+    return "unsupported size " + std::to_string(program.width) + "x" + std::to_string(program.size);
+}
+
+/**
+ * Collects the programs in 'path': every .2l file if it is a directory,
+ * otherwise every block of lines separated by empty lines. Either way a
+ * program ends at its first empty line, so files may have notes after it.
+ */
+inline void collect_programs(std::string const& path,
+                             std::vector<std::unique_ptr<MappedFile>>& files,
+                             std::vector<ProgramText>& programs)
+{
+    DIR* dir = opendir(path.c_str());
+    if (dir) {
+        std::vector<std::string> names;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, ".2l") == 0) {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (std::string const& name : names) {
+            files.emplace_back(new MappedFile(path + "/" + name));
+            ProgramText program;
+            program.name = name;
+            parse_program(files.back()->begin(), files.back()->end(), program, ProgramEnd::empty_line);
+            programs.push_back(program);
+        }
+        return;
+    }
+
+    files.emplace_back(new MappedFile(path));
+    const char* p = files.back()->begin();
+    const char* end = files.back()->end();
+    unsigned int line = 1;
+    while (p != end) {
+        if (*p == '\n' || *p == '\r') {
+            line += *p == '\n';
+            ++p;
+            continue;
+        }
+        ProgramText program;
+        program.name = path + ":" + std::to_string(line);
+        p = parse_program(p, end, program, ProgramEnd::empty_line);
+        line += program.size;
+        programs.push_back(program);
+    }
+}
+
+/**
+ * Evaluates all programs in 'path' in parallel and prints one line per program
+ */
+inline void run_batch(std::string const& path, unsigned int max_steps = 1000000)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<ProgramText> programs;
+    try {
+        collect_programs(path, files, programs);
+    }
+    catch (std::runtime_error const& e) {
+        std::cout << e.what() << std::endl;
+        return;
+    }
+
+    std::vector<std::string> results(programs.size());
+    std::atomic<std::size_t> next_program{0};
+    auto worker = [&]() {
+        for (std::size_t i = next_program++; i < programs.size(); i = next_program++) {
+            if (programs[i].valid()) {
+                results[i] = evaluate_program<max_batch_size>(programs[i], max_steps);
+            }
+            else {
+                results[i] = "invalid: " + programs[i].error;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int t = 0; t != num_threads; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    for (std::size_t i = 0; i != programs.size(); ++i) {
+        std::cout << programs[i].name << ": " << results[i] << std::endl;
+    }
+    auto current_time = std::chrono::steady_clock::now();
+    unsigned int duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
+    std::cout << "Evaluated " << programs.size() << " programs on " << num_threads << " threads in "
+              << duration_ms/1000 << " seconds, " << duration_ms%1000 << " milliseconds" << std::endl;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Neighbour table of a rectangular board. Cells are numbered by serial
+ * y*width+x; serial width*height is a virtual entry cell outside the board,
+ * from which only 'entry_direction' leads onto the board, at (0, 0).
+ */
+class Geometry
+{
+public:
+    Geometry(int width, int height, int entry_direction) :
+        m_width{width},
+        m_height{height},
+        m_next(4*(width*height+1), -1)
+    {
+        for (int y = 0; y != height; ++y) {
+            for (int x = 0; x != width; ++x) {
+                int s = y*width + x;
+                m_next[4*s+0] = y == 0 ? -1 : s - width;          /* up */
+                m_next[4*s+1] = x == width-1 ? -1 : s + 1;        /* right */
+                m_next[4*s+2] = y == height-1 ? -1 : s + width;   /* down */
+                m_next[4*s+3] = x == 0 ? -1 : s - 1;              /* left */
+            }
+        }
+        m_next[4*entry() + entry_direction] = 0;
+    }
+
+    int width() const
+    {
+        return m_width;
+    }
+
+    int height() const
+    {
+        return m_height;
+    }
+
+    int entry() const
+    {
+        return m_width*m_height;
+    }
+
+    /**
+     * The serial next to 'serial' in direction d, or -1 if that is off the board
+     */
+    int next(int serial, int d) const
+    {
+        return m_next[4*serial + d];
+    }
+
+private:
+    int m_width;
+    int m_height;
+    std::vector<int> m_next;
+};
+
+enum class StepResult { ok, done, overflow, undecided };
+
+// cell value of a partially specified field, for cells that have not been decided yet
+const char undecided_cell = '?';
+
+// effect of '*' per direction (up, right, down, left) on the memory location and the memory value
+const int star_move_mem_loc[4] = {-1, 0, 1, 0};
+const int star_add_mem[4] = {0, 1, 0, -1};
+
+/**
+ * One 2L step, shared by the enumerator and the general interpreter. The
+ * Machine provides cell(serial), mem_nonzero() and star(d), which returns
+ * false on a memory overflow. On reading an undecided cell, the step stops
+ * before changing anything but the direction: once g.next(pos, d) has been
+ * decided, the same step can simply be done again.
+ */
+template <typename Machine>
+inline StepResult do_2l_step(Geometry const& g, int& pos, int& d, Machine& m)
+{
+    while (true) {
+        int next = g.next(pos, d);
+        if (next < 0) {
+            return StepResult::done;
+        }
+        char c = m.cell(next);
+        if (c == undecided_cell) {
+            return StepResult::undecided;
+        }
+        if (c != '+') {
+            pos = next;
+            break;
+        }
+        d = m.mem_nonzero() ? (d+1)%4 /* turn right */ : (d+3)%4 /* turn left */;
+    }
+    if (m.cell(pos) == '*' && !m.star(d)) {
+        return StepResult::overflow;
+    }
+    return StepResult::ok;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Hardware counters of the calling thread (user space only) via perf_event_open:
+ * cycles, branch misses and L1 data cache read misses, counted as one group.
+ */
+class PerfCounters
+{
+public:
+    enum Counter { cycles, branch_misses, l1d_misses, num_counters };
+
+    struct Values
+    {
+        uint64_t value[num_counters];
+    };
+
+    PerfCounters()
+    {
+        for (int c = 0; c != num_counters; ++c) {
+            m_fd[c] = -1;
+        }
+        m_fd[cycles] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (m_fd[cycles] < 0) {
+            m_error = strerror(errno);
+            return;
+        }
+        m_fd[branch_misses] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, m_fd[cycles]);
+        m_fd[l1d_misses] = open_counter(PERF_TYPE_HW_CACHE,
+                                        PERF_COUNT_HW_CACHE_L1D |
+                                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                        m_fd[cycles]);
+        if (m_fd[branch_misses] < 0 || m_fd[l1d_misses] < 0) {
+            m_error = strerror(errno);
+        }
+    }
+
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+
+    ~PerfCounters()
+    {
+        for (int c = 0; c != num_counters; ++c) {
+            if (m_fd[c] >= 0) {
+                close(m_fd[c]);
+            }
+        }
+    }
+
+    bool available() const
+    {
+        return m_error.empty();
+    }
+
+    std::string const& error() const
+    {
+        return m_error;
+    }
+
+    void start()
+    {
+        if (available()) {
+            ioctl(m_fd[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(m_fd[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    Values stop()
+    {
+        Values result{};
+        if (available()) {
+            ioctl(m_fd[cycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t buf[1 + num_counters];
+            if (read(m_fd[cycles], buf, sizeof(buf)) == static_cast<ssize_t>(sizeof(buf))) {
+                for (int c = 0; c != num_counters; ++c) {
+                    result.value[c] = buf[1 + c];
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    static int open_counter(uint32_t type, uint64_t config, int group_fd)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group_fd < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+    int m_fd[num_counters];
+    std::string m_error;
+};
@@ -1,10 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
-#include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
+// a number of fields, or a field number: 3^(N*N) exceeds 64 bits from N=7 on
+using FieldCount = unsigned __int128;
+
+inline std::string count_to_string(FieldCount n)
+{
+    std::string result;
+    do {
+        result.insert(result.begin(), static_cast<char>('0' + static_cast<int>(n % 10)));
+        n /= 10;
+    }
+    while (n != 0);
+    return result;
+}
+
 template <int N>
 int XY(int x, int y)
 {
@@ -30,11 +45,6 @@ public:
         return !(*this == other);
     }
 
-    bool operator>(Pos other) const
-    {
-        return serial() > other.serial();
-    }
-
     void to_stream(std::ostream & os) const
     {
         os << "(" << m_x << ", " << m_y << ")";
@@ -44,44 +54,6 @@ public:
     {
         return m_serial;
     }
-
-    void move(int d, bool& out_of_bounds)
-    {
-        switch (d) {
-            case 0: /* up */
-                if ( m_y == 0 ) {
-                    out_of_bounds = true;
-                    return;
-                }
-                --m_y;
-                m_serial -= N;
-                break;
-            case 1: /* right */
-                if ( m_x == N-1 ) {
-                    out_of_bounds = true;
-                    return;
-                }
-                ++m_x;
-                ++m_serial;
-                break;
-            case 2: /* down */
-                if ( m_y == N-1 ) {
-                    out_of_bounds = true;
-                    return;
-                }
-                ++m_y;
-                m_serial += N;
-                break;
-            case 3: /* left */
-                if ( m_x == 0 ) {
-                    out_of_bounds = true;
-                    return;
-                }
-                --m_x;
-                --m_serial;
-                break;
-        }
-    }
 };
 
 template <int N>
@@ -91,6 +63,16 @@ std::ostream & operator<<(std::ostream &os, Pos<N> const& p)
     return os;
 }
 
+/**
+ * State of an enumeration in Gray code order, see Field<N>::next_gray():
+ * whether each cell currently runs through its values backwards
+ */
+template <int N>
+struct GrayDirections
+{
+    bool down[N*N] = {};
+};
+
 template <int N>
 class Field
 {
@@ -115,12 +97,9 @@ public:
         return pbuf[p.serial()];
     }
 
-    char get(Pos<N> p, Pos<N>& max_pos) const
+    char get(int serial) const
     {
-        if (p > max_pos) {
-            max_pos = p;
-        }
-        return pbuf[p.serial()];
+        return pbuf[serial];
     }
 
     void set(int x, int y, char c)
@@ -151,6 +130,45 @@ public:
         while (!is_valid_iter());
     }
 
+    /**
+     * Alternative to next(serials_used) in reflected Gray code order: every call
+     * changes exactly one cell. The same fields are visited, except that cells
+     * which are never read may hold a different (irrelevant) value, see
+     * blank_except(). Returns false when all fields have been visited.
+     */
+    bool next_gray(std::vector<int> const& serials_used, GrayDirections<N>& directions)
+    {
+        const char order[] = {' ', '*', '+'};
+        const int sizeOfArray = sizeof(order) / sizeof(order[0]);
+        for (auto serial_it = serials_used.rbegin(); serial_it != serials_used.rend(); ++serial_it) {
+            int s = *serial_it;
+            int j = std::find(order, order + sizeOfArray, pbuf[s]) - order;
+            const int step = directions.down[s] ? -1 : 1;
+            for (j += step; j >= 0 && j < sizeOfArray; j += step) {
+                if (is_valid_value(s, order[j])) {
+                    pbuf[s] = order[j];
+                    return true;
+                }
+            }
+            // this cell is at the end of its range: reverse it and carry
+            directions.down[s] = !directions.down[s];
+        }
+        return false;
+    }
+
+    /**
+     * The field with ' ' in all cells except 'serials_used', as next(serials_used) would have it
+     */
+    Field<N> blank_except(std::vector<int> const& serials_used) const
+    {
+        Field<N> result;
+        memset(result.pbuf, ' ', N*N);
+        for (int s : serials_used) {
+            result.pbuf[s] = pbuf[s];
+        }
+        return result;
+    }
+
     constexpr int size()
     {
         return N;
@@ -186,6 +204,55 @@ public:
         }
     }
 
+    /**
+     * Number of valid fields that are identical on the given cells. An integer,
+     * so that sums do not depend on the order in which they are added up.
+     */
+    static FieldCount count_completions(std::vector<int> const& serials)
+    {
+        bool fixed[N*N] = {};
+        for (int s : serials) {
+            fixed[s] = true;
+        }
+        FieldCount result = 1;
+        for (int s = 0; s != N*N; ++s) {
+            if (!fixed[s]) {
+                result *= is_valid_value(s, ' ') + is_valid_value(s, '*') + is_valid_value(s, '+');
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Increases in next(serials_used) order, also between fields that are not
+     * consecutive in it: the cells in 'serials_used' as base 3 digits, with
+     * ' ', '*' and '+' as 0, 1 and 2, padded with zeros to N*N digits.
+     */
+    FieldCount enumeration_key(std::vector<int> const& serials_used) const
+    {
+        static_assert(N <= 8, "larger fields do not fit in 128 bits");
+        FieldCount result = 0;
+        for (int i = 0; i != N*N; ++i) {
+            char c = i < static_cast<int>(serials_used.size()) ? pbuf[serials_used[i]] : ' ';
+            result = 3*result + (c == '*' ? 1 : c == '+' ? 2 : 0);
+        }
+        return result;
+    }
+
+    // same restrictions as is_valid_iter(), for a single cell
+    static bool is_valid_value(int serial, char c)
+    {
+        if (serial == 0) {
+            return c == '*';
+        }
+        int x = serial % N;
+        int y = serial / N;
+        if (c == '*' && ((x == N-1 && y != 0) || (y == N-1 && x != 0))) {
+            return false;
+        }
+        return true;
+    }
+
 private:
 
     bool is_valid_iter()
@@ -247,20 +314,3 @@ Field<N> from_iter(unsigned long iter)
     }
     return f;
 }
-
-template <int N>
-Field<N> read_file(std::string const& filename)
-{
-    Field<N> f;
-    std::ifstream infile(filename);
-    for (int y = 0; y != N; y++) {
-        std::string line;
-        getline( infile, line );
-        std::cout << line << std::endl;
-        for (int x = 0; x != N; x++) {
-            f.set(x, y, line[x]);
-        }
-    }
-    return f;
-}
-
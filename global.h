@@ -4,3 +4,24 @@ const unsigned int debug_level = 0;
 //const unsigned int debug_level = 1;
 const std::string g_filename;
 //const std::string g_filename = "../2l_busy_beaver/2l_busy_beaver/files/5x5_problem.2l";
+const std::string g_program_filename;
+//const std::string g_program_filename = "../2l_busy_beaver/2l_busy_beaver/files/HelloWorld.2l";
+const bool g_benchmark_program = false;
+const std::string g_batch_path;
+//const std::string g_batch_path = "../2l_busy_beaver/2l_busy_beaver/files";
+
+enum class EnumerationOrder { odometer, gray };
+const EnumerationOrder g_enumeration_order = EnumerationOrder::odometer;
+//const EnumerationOrder g_enumeration_order = EnumerationOrder::gray;
+
+// search depth first over partially specified fields instead of enumerating complete fields
+const bool g_lazy_search = false;
+//const bool g_lazy_search = true;
+
+// evaluate with a small step budget first and continue unresolved runs with growing budgets
+const bool g_staged_budget = false;
+//const bool g_staged_budget = true;
+
+// directory with the results of each size: a sweep reuses those of the size below and writes its own
+const std::string g_result_cache_directory;
+//const std::string g_result_cache_directory = ".";
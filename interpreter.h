@@ -0,0 +1,121 @@
+#pragma once
+
+#include "core.h"
+#include "loader.h"
+#include <string>
+#include <vector>
+
+/**
+ * Interpreter for complete 2L programs: rectangular boards of any size and
+ * the I/O cells. As in the 2L language, the program is entered at the top
+ * left corner moving down and the tape pointer starts at TL2. A '*' moving
+ * left or right on TL1 does I/O instead: if TL0 is zero, a character is read
+ * into TL0, otherwise TL0 is written to the output and cleared.
+ */
+class Interpreter
+{
+public:
+    explicit Interpreter(ProgramText const& program) :
+        m_geometry(program.width, program.size, 2),
+        m_cells(program.width*program.size + 1, ' ')
+    {
+        copy_cells(program, program.width, m_cells.data());
+        reset();
+    }
+
+    void reset(std::string const& input = "")
+    {
+        m_pos = m_geometry.entry();
+        m_d = 2;
+        std::fill(m_tape.begin(), m_tape.end(), 0);
+        m_tape.resize(initial_tape_size, 0);
+        m_mloc = 2;
+        m_input = input;
+        m_input_pos = 0;
+        m_output.clear();
+    }
+
+    enum class ResultType { finite, error };
+    struct Result
+    {
+        ResultType type;
+        unsigned long steps;
+    };
+
+    Result execute(unsigned long max_steps)
+    {
+        for (unsigned long step = 0; step != max_steps; ++step) {
+            StepResult step_result = do_2l_step(m_geometry, m_pos, m_d, *this);
+            if (step_result == StepResult::done) {
+                return Result{ResultType::finite, step};
+            }
+            else if (step_result == StepResult::overflow) {
+                return Result{ResultType::error, step};
+            }
+        }
+        return Result{ResultType::error, max_steps};
+    }
+
+    /**
+     * Everything written by the program since the last reset
+     */
+    std::string const& output() const
+    {
+        return m_output;
+    }
+
+    // interface for do_2l_step()
+    char cell(int serial) const
+    {
+        return m_cells[serial];
+    }
+
+    bool mem_nonzero() const
+    {
+        return m_tape[m_mloc] != 0;
+    }
+
+    bool star(int d)
+    {
+        if (star_move_mem_loc[d]) {
+            m_mloc += star_move_mem_loc[d];
+            if (m_mloc < 0) {
+                return false;
+            }
+            if (m_mloc == static_cast<int>(m_tape.size())) {
+                m_tape.resize(2*m_tape.size(), 0);
+            }
+        }
+        else if (m_mloc == 1) {
+            do_io();
+        }
+        else {
+            m_tape[m_mloc] += star_add_mem[d];
+        }
+        return true;
+    }
+
+private:
+    static const int initial_tape_size = 30000;
+
+    void do_io()
+    {
+        if (m_tape[0] == 0) {
+            m_tape[0] = m_input_pos != m_input.size() ? static_cast<unsigned char>(m_input[m_input_pos++]) : 0;
+        }
+        else {
+            m_output.push_back(static_cast<char>(m_tape[0]));
+            m_tape[0] = 0;
+        }
+    }
+
+    Geometry m_geometry;
+    std::vector<char> m_cells;
+    int m_pos;
+    int m_d;
+    std::vector<int> m_tape;
+    int m_mloc;
+    std::string m_input;
+    std::string::size_type m_input_pos;
+    std::string m_output;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "field.h"
+#include "run.h"
+#include <memory>
+#include <vector>
+
+/**
+ * Depth-first search over partially specified fields. All cells start
+ * undecided; a run continues until it reads an undecided cell, and then
+ * every valid value of that cell is tried from a copy of the run so far.
+ * Every distinct prefix is therefore executed once. The leaves are found
+ * in the same order as the fields of Field<N>::next(serials_used).
+ */
+template <int N>
+class LazySearch
+{
+public:
+    explicit LazySearch(unsigned int max_steps) : m_max_steps{max_steps}
+    {
+        for (int i = 0; i != N*N+1; ++i) {
+            m_runs.emplace_back(new Run<N>());
+        }
+    }
+
+    void set_max_steps(unsigned int max_steps)
+    {
+        m_max_steps = max_steps;
+    }
+
+    /**
+     * Calls on_leaf(result, field, weight, run) for every leaf, until on_leaf
+     * returns false. The field still contains undecided cells (see complete())
+     * and weight is the number of complete fields the leaf stands for.
+     */
+    template <typename OnLeaf>
+    void run(OnLeaf&& on_leaf)
+    {
+        Field<N> f;
+        for (int y = 0; y != N; y++) {
+            for (int x = 0; x != N; x++) {
+                f.set(x, y, undecided_cell);
+            }
+        }
+        f.set(0, 0, '*');
+        m_runs[0]->reset(f);
+        search(0, f, on_leaf);
+    }
+
+    /**
+     * Like run(), for the subtree below a run of the partially specified field f
+     */
+    template <typename OnLeaf>
+    void run_from(Run<N> const& start, Field<N>& f, OnLeaf&& on_leaf)
+    {
+        m_runs[0]->copy_from(start, f);
+        search(0, f, on_leaf);
+    }
+
+    /**
+     * The field with undecided cells set to ' '
+     */
+    static Field<N> complete(Field<N> const& f)
+    {
+        Field<N> result = f;
+        for (int y = 0; y != N; y++) {
+            for (int x = 0; x != N; x++) {
+                if (f.get(Pos<N>(x, y)) == undecided_cell) {
+                    result.set(x, y, ' ');
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    template <typename OnLeaf>
+    bool search(int depth, Field<N>& f, OnLeaf&& on_leaf)
+    {
+        Run<N>& r = *m_runs[depth];
+        typename Run<N>::Result result = r.execute(m_max_steps);
+        if (result.type != Run<N>::ResultType::undecided) {
+            return on_leaf(result, f, Field<N>::count_completions(r.get_serials_used()), r);
+        }
+
+        const int s = r.undecided_serial();
+        const char order[] = {' ', '*', '+'};
+        bool more = true;
+        for (unsigned int j = 0; j != sizeof(order) && more; ++j) {
+            if (Field<N>::is_valid_value(s, order[j])) {
+                f.set(s % N, s / N, order[j]);
+                m_runs[depth+1]->copy_from(r);
+                more = search(depth+1, f, on_leaf);
+            }
+        }
+        f.set(s % N, s / N, undecided_cell);
+        return more;
+    }
+
+    unsigned int m_max_steps;
+    // every decision adds a cell, so N*N+1 runs suffice
+    std::vector<std::unique_ptr<Run<N>>> m_runs;
+};
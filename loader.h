@@ -0,0 +1,195 @@
+#pragma once
+
+#include "field.h"
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only memory mapping of a whole file
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + filename);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot stat " + filename);
+        }
+        m_size = st.st_size;
+        if (m_size) {
+            void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("cannot map " + filename);
+            }
+            m_data = static_cast<const char*>(p);
+        }
+        close(fd);
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile()
+    {
+        if (m_data) {
+            munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    const char* begin() const
+    {
+        return m_data;
+    }
+
+    const char* end() const
+    {
+        return m_data + m_size;
+    }
+
+private:
+    const char* m_data{nullptr};
+    std::size_t m_size{0};
+};
+
+/**
+ * A 2L program as a range of text lines, which are not copied. 'size' is the
+ * number of lines and 'width' the longest line; shorter lines are padded with ' '.
+ */
+struct ProgramText
+{
+    std::string name;
+    const char* begin{nullptr};
+    const char* end{nullptr};
+    int size{0};
+    int width{0};
+    std::string error;
+
+    bool valid() const
+    {
+        return error.empty();
+    }
+
+    bool square() const
+    {
+        return width <= size;
+    }
+};
+
+namespace {
+inline const char* end_of_line(const char* p, const char* end)
+{
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+inline const char* strip_cr(const char* begin, const char* eol)
+{
+    return (eol != begin && eol[-1] == '\r') ? eol - 1 : eol;
+}
+}
+
+// where a program ends: at the end of the text, or at the first empty line when a text holds several programs
+enum class ProgramEnd { end_of_text, empty_line };
+
+/**
+ * Parses and validates the program starting at 'begin'. With ProgramEnd::end_of_text,
+ * empty lines are blank rows; with ProgramEnd::empty_line, the program ends at the
+ * first empty line. Returns a pointer to where the program ends.
+ */
+inline const char* parse_program(const char* begin, const char* end, ProgramText& program,
+                                 ProgramEnd program_end = ProgramEnd::end_of_text)
+{
+    program.begin = begin;
+    program.size = 0;
+    program.width = 0;
+    program.error.clear();
+    const char* p = begin;
+    while (p != end) {
+        const char* eol = end_of_line(p, end);
+        const char* row_end = strip_cr(p, eol);
+        if (row_end == p && program_end == ProgramEnd::empty_line) {
+            break;
+        }
+        for (const char* c = p; c != row_end && program.error.empty(); ++c) {
+            if (*c != ' ' && *c != '*' && *c != '+') {
+                program.error = "invalid character '" + std::string(1, *c) + "' in row " + std::to_string(program.size + 1);
+            }
+        }
+        program.width = std::max(program.width, static_cast<int>(row_end - p));
+        ++program.size;
+        p = eol == end ? end : eol + 1;
+    }
+    program.end = p;
+    if (program.error.empty() && program.size == 0) {
+        program.error = "empty program";
+    }
+    return p;
+}
+
+/**
+ * Writes the cells of the program row by row into 'out', which must hold width*size chars
+ */
+inline void copy_cells(ProgramText const& program, int width, char* out)
+{
+    const char* p = program.begin;
+    for (int y = 0; y != program.size; y++) {
+        const char* eol = end_of_line(p, program.end);
+        const int row_width = strip_cr(p, eol) - p;
+        for (int x = 0; x != width; x++) {
+            out[y*width + x] = x < row_width ? p[x] : ' ';
+        }
+        p = eol == program.end ? eol : eol + 1;
+    }
+}
+
+// rows missing at the bottom are blank
+template <int N>
+Field<N> to_field(ProgramText const& program)
+{
+    char cells[N*N];
+    memset(cells, ' ', sizeof(cells));
+    copy_cells(program, N, cells);
+    Field<N> f;
+    for (int y = 0; y != N; y++) {
+        for (int x = 0; x != N; x++) {
+            f.set(x, y, cells[y*N + x]);
+        }
+    }
+    return f;
+}
+
+/**
+ * Reads the field from the first N lines of a .2l file; empty or short lines
+ * are padded with ' ', and any text after the N lines is ignored
+ */
+template <int N>
+Field<N> read_file(std::string const& filename)
+{
+    MappedFile file(filename);
+    const char* rows_end = file.begin();
+    for (int y = 0; y != N && rows_end != file.end(); y++) {
+        const char* eol = end_of_line(rows_end, file.end());
+        rows_end = eol == file.end() ? eol : eol + 1;
+    }
+    ProgramText program;
+    parse_program(file.begin(), rows_end, program);
+    if (program.valid() && program.width > N) {
+        program.error = "program has size " + std::to_string(program.width) + "x" + std::to_string(program.size) + ", expected " + std::to_string(N) + "x" + std::to_string(N);
+    }
+    if (!program.valid()) {
+        throw std::runtime_error(filename + ": " + program.error);
+    }
+    return to_field<N>(program);
+}
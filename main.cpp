@@ -1,10 +1,21 @@
+#include "batch.h"
+#include "counters.h"
 #include "field.h"
+#include "interpreter.h"
+#include "lazy_search.h"
+#include "loader.h"
+#include "result_cache.h"
 #include "run.h"
+#include "staged_search.h"
 #include "state.h"
+#include "statistics.h"
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <sstream>
 
 constexpr unsigned long powr(unsigned long a, unsigned long b)
 {
@@ -40,7 +51,15 @@ void test_next()
 template <int N>
 void run_from_file(std::string const& filename)
 {
-    Field<N> f = read_file<N>(filename);
+    Field<N> f;
+    try {
+        f = read_file<N>(filename);
+    }
+    catch (std::runtime_error const& e) {
+        std::cout << e.what() << std::endl;
+        return;
+    }
+    f.print();
     Run<N> r;
     r.reset(f);
     typename Run<N>::Result result = r.execute(1000000);
@@ -55,84 +74,343 @@ void run_from_file(std::string const& filename)
         case Run<N>::ResultType::infinite:
             std::cout << "Infinite number of steps" << std::endl;
         break;
+        case Run<N>::ResultType::undecided:
+        break;
     }
 }
 
-template <int N>
-class Statistics
+void run_program(std::string const& filename, bool benchmark)
 {
-public:
-    void add_result(typename Run<N>::Result result)
-    {
-        ++m_result_count[static_cast<int>(result.type)];
+    std::unique_ptr<MappedFile> file;
+    ProgramText program;
+    try {
+        file.reset(new MappedFile(filename));
     }
-
-    void print(std::ostream& os)
-    {
-        os << "Statistics:" << std::endl;
-        os << "finite: " << m_result_count[static_cast<int>(Run<N>::ResultType::finite)] << std::endl;
-        os << "infinite: " << m_result_count[static_cast<int>(Run<N>::ResultType::infinite)] << std::endl;
-        os << "error: " << m_result_count[static_cast<int>(Run<N>::ResultType::error)] << std::endl;
+    catch (std::runtime_error const& e) {
+        std::cout << e.what() << std::endl;
+        return;
+    }
+    parse_program(file->begin(), file->end(), program);
+    if (!program.valid()) {
+        std::cout << filename << ": " << program.error << std::endl;
+        return;
+    }
+    Interpreter interpreter(program);
+    Interpreter::Result result = interpreter.execute(1000000000);
+    std::cout << interpreter.output();
+    std::cout << "Stopped after " << result.steps << " steps" << std::endl;
+    if (result.type == Interpreter::ResultType::error) {
+        std::cout << "Evaluation failed" << std::endl;
+    }
+    if (!benchmark) {
+        return;
     }
 
-private:
-    std::array<unsigned long, static_cast<int>(Run<N>::ResultType::LAST_VALUE)+1> m_result_count;
+    unsigned long total_steps = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    unsigned int duration_ms = 0;
+    while (duration_ms < 1000) {
+        interpreter.reset();
+        total_steps += interpreter.execute(1000000000).steps;
+        auto current_time = std::chrono::steady_clock::now();
+        duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
+    }
+    std::cout << "Benchmark: " << total_steps*1000/duration_ms << " steps/sec" << std::endl;
+}
 
-};
+std::string result_cache_filename(int n)
+{
+    return g_result_cache_directory + "/" + std::to_string(n) + "x" + std::to_string(n) + ".results";
+}
 
 template <int N>
-void investigate()
+void investigate(unsigned long max_fields = static_cast<unsigned long>(-1))
 {
+    const unsigned int max_steps = 1000000;
+    const bool use_cache = !g_result_cache_directory.empty();
+    std::unique_ptr<ResultCache<N>> results;
+    ResultCache<N-1> smaller_results(max_steps);
+    if (use_cache) {
+        results.reset(new ResultCache<N>(max_steps));
+    }
+    if (use_cache && !g_staged_budget && !g_lazy_search) {
+        try {
+            smaller_results.load(result_cache_filename(N-1));
+        }
+        catch (std::runtime_error const& e) {
+            std::cout << "No results to reuse: " << e.what() << std::endl;
+        }
+    }
+    unsigned long reused = 0;
+
     unsigned long iter = 0;
-    unsigned int max_steps = 0;
-    Field<N> orig = first_field<N>();
-    Field<N> best_field = orig;
-//    std::vector<Field<SIZE>> error_fields;
-    unsigned int num_error_fields = 0;
-    auto start_time = std::chrono::steady_clock::now();
-    Run<N> r;
-    Field<N> f = orig;
     Statistics<N> statistics;
-    do
-    {
-        r.reset(f);
-        typename Run<N>::Result result = r.execute(1000000);
-        statistics.add_result(result);
-        if (result.type == Run<N>::ResultType::error) {
-//            std::cout << "Field could not be evaluated: " << std::endl;
-//            f.print();
-//            error_fields.push_back(f);
-            ++num_error_fields;
-        }
-        else if ( result.type == Run<N>::ResultType::finite && result.steps > max_steps ) {
+    auto add_field = [&](typename Run<N>::Result result, Field<N> const& f, std::vector<int> const& serials, FieldCount weight) {
+        if ( result.type == Run<N>::ResultType::finite && result.steps > statistics.max_steps() ) {
             std::cout << "Found new best with total steps: " << result.steps << std::endl;
             f.print();
-            max_steps = result.steps;
-            best_field = f;
         }
-        f.next(r.get_serials_used());
+        statistics.add_result(result, f, serials, weight);
         if (iter % 1000000 == 0 || debug_level != 0) {
             printf("iter = %ld\n", iter);
             fflush(stdout);
         }
         ++iter;
+        return iter != max_fields;
+    };
+    auto start_time = std::chrono::steady_clock::now();
+    StagedSearch<N> staged_search(10000, 10, max_steps);
+    if (g_staged_budget) {
+        staged_search.run();
+        statistics.merge(staged_search.statistics());
+        iter = statistics.total_count();
+    }
+    else if (g_lazy_search) {
+        LazySearch<N> search(max_steps);
+        search.run([&](typename Run<N>::Result result, Field<N> const& f, FieldCount weight, Run<N> const& r) {
+            if (use_cache) {
+                results->add(LazySearch<N>::complete(f), RunSummary<N>{result, r.get_serials_used(), r.position(), r.direction()});
+            }
+            return add_field(result, LazySearch<N>::complete(f), r.get_serials_used(), weight);
+        });
+    }
+    else {
+        Field<N> orig = first_field<N>();
+        Run<N> r;
+        Field<N> f = orig;
+        GrayDirections<N> gray_directions;
+        RunSummary<N> cached;
+        bool more_fields = true;
+        do
+        {
+            typename Run<N>::Result result;
+            std::vector<int> const* serials_used = &r.get_serials_used();
+            // Gray code order leaves stale values in unread cells, which hardly ever match the cache
+            if (smaller_results.loaded() && smaller_results.find_larger(f, cached)) {
+                result = cached.result;
+                serials_used = &cached.serials;
+                ++reused;
+            }
+            else {
+                r.reset(f);
+                result = r.execute(max_steps);
+                if (use_cache) {
+                    cached = RunSummary<N>{result, r.get_serials_used(), r.position(), r.direction()};
+                }
+            }
+            std::vector<int> const& serials = *serials_used;
+            // in Gray code order, unread cells keep values from earlier fields
+            Field<N> const& reported = g_enumeration_order == EnumerationOrder::gray ? f.blank_except(serials) : f;
+            if (use_cache) {
+                results->add(reported, cached);
+            }
+            more_fields = add_field(result, reported, serials, Field<N>::count_completions(serials));
+            if (g_enumeration_order == EnumerationOrder::gray) {
+                more_fields = f.next_gray(serials, gray_directions) && more_fields;
+            }
+            else {
+                f.next(serials);
+                more_fields = f != orig && more_fields;
+            }
+        }
+        while (more_fields);
     }
-    while (f != orig);
     auto current_time = std::chrono::steady_clock::now();
     unsigned int duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
     std::cout << N << "x" << N << std::endl;
     std::cout << "Evalution took " << duration_ms/1000 << " seconds, " << duration_ms%1000 << " milliseconds" << std::endl;
-    std::cout << "There were " << num_error_fields << " fields with failed evaluation" << std::endl;
-    printf("Number of fields: %ld, maximum number of steps: %d\n", iter, max_steps);
-    best_field.print();
+    if (g_staged_budget) {
+        std::cout << "Staged depth-first search";
+    }
+    else if (g_lazy_search) {
+        std::cout << "Depth-first search";
+    }
+    else {
+        std::cout << (g_enumeration_order == EnumerationOrder::gray ? "Gray code" : "Odometer") << " order";
+    }
+    std::cout << ": " << (duration_ms ? iter*1000/duration_ms : iter*1000) << " fields/sec" << std::endl;
+    if (smaller_results.loaded()) {
+        std::cout << "Results reused from " << N-1 << "x" << N-1 << ": " << reused << std::endl;
+    }
+    if (use_cache && !g_staged_budget && iter != max_fields) {
+        try {
+            results->save(result_cache_filename(N));
+        }
+        catch (std::runtime_error const& e) {
+            std::cout << e.what() << std::endl;
+        }
+    }
+    std::cout << "There were " << statistics.count(Run<N>::ResultType::error) << " fields with failed evaluation" << std::endl;
+    printf("Number of fields: %ld, maximum number of steps: %d\n", iter, statistics.max_steps());
+    statistics.print_top(std::cout);
     statistics.print(std::cout);
+    if (g_staged_budget) {
+        staged_search.print_stages(std::cout);
+    }
+}
+
+/**
+ * Compares the staged search and its worker threads with a single-threaded
+ * sweep of Run<N>: the statistics, including the checksum over every
+ * (field, result type, steps), and the top fields must be identical.
+ */
+template <int N>
+bool verify_staged_search()
+{
+    const unsigned int max_steps = 1000000;
+    Statistics<N> reference;
+    Field<N> orig = first_field<N>();
+    Field<N> f = orig;
+    Run<N> r;
+    unsigned long iter = 0;
+    do {
+        r.reset(f);
+        typename Run<N>::Result result = r.execute(max_steps);
+        reference.add_result(result, f, r.get_serials_used(), Field<N>::count_completions(r.get_serials_used()));
+        ++iter;
+        f.next(r.get_serials_used());
+    }
+    while (f != orig);
+
+    // a small first budget sends most fields through the workers
+    StagedSearch<N> staged_search(10, 10, max_steps);
+    staged_search.run();
+    Statistics<N> const& staged = staged_search.statistics();
+
+    std::ostringstream reference_text, staged_text;
+    reference.print(reference_text);
+    staged.print(staged_text);
+    bool same = reference_text.str() == staged_text.str();
+    std::vector<typename Statistics<N>::Entry> reference_top = reference.top();
+    std::vector<typename Statistics<N>::Entry> staged_top = staged.top();
+    same = same && reference_top.size() == staged_top.size();
+    for (std::size_t i = 0; same && i != reference_top.size(); ++i) {
+        same = reference_top[i].steps == staged_top[i].steps && reference_top[i].field == staged_top[i].field;
+    }
+    std::cout << N << "x" << N << ": " << iter << " fields, checksum " << std::hex << std::setw(16) << std::setfill('0')
+              << reference.checksum() << " and " << std::setw(16) << staged.checksum() << std::dec << std::setfill(' ')
+              << (same ? ", identical" : ", DIFFERENT") << std::endl;
+    if (!same) {
+        std::cout << "Single-threaded:" << std::endl << reference_text.str()
+                  << "Staged:" << std::endl << staged_text.str();
+    }
+    return same;
+}
+
+void print_phase(std::string const& name, unsigned int duration_ms, PerfCounters const& counters, PerfCounters::Values const& v)
+{
+    std::cout << name << ": " << duration_ms << " ms";
+    if (counters.available()) {
+        std::cout << ", " << v.value[PerfCounters::cycles] << " cycles, "
+                  << v.value[PerfCounters::branch_misses] << " branch misses, "
+                  << v.value[PerfCounters::l1d_misses] << " L1 misses";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * Hardware counters per phase over the first 'num_fields' fields of investigate<N>().
+ * Run::detect_loop() cannot be isolated without changing the runs, so its share is
+ * the full execution minus a replay of the same number of do_step() calls.
+ */
+template <int N>
+void profile_phases(unsigned long num_fields)
+{
+    const unsigned int max_steps = 1000000;
+    PerfCounters counters;
+    if (!counters.available()) {
+        std::cout << "Hardware counters unavailable: " << counters.error() << std::endl;
+    }
+
+    // record the workload
+    std::vector<Field<N>> fields;
+    std::vector<std::vector<int>> serials;
+    std::vector<unsigned int> step_calls;
+    Field<N> orig = first_field<N>();
+    Field<N> f = orig;
+    Run<N> r;
+    do {
+        r.reset(f);
+        typename Run<N>::Result result = r.execute(max_steps);
+        fields.push_back(f);
+        serials.push_back(r.get_serials_used());
+        step_calls.push_back(std::min(result.steps + 1, max_steps));
+        f.next(r.get_serials_used());
+    }
+    while (f != orig && fields.size() != num_fields);
+
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::time_point a, clock::time_point b) {
+        return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count());
+    };
+
+    auto start_time = clock::now();
+    counters.start();
+    for (std::size_t i = 0; i != fields.size(); ++i) {
+        r.reset(fields[i]);
+        r.execute(max_steps);
+    }
+    PerfCounters::Values execute_values = counters.stop();
+    auto execute_time = clock::now();
+
+    counters.start();
+    for (std::size_t i = 0; i != fields.size(); ++i) {
+        r.reset(fields[i]);
+        for (unsigned int step = 0; step != step_calls[i]; ++step) {
+            if (r.do_step() != StepResult::ok) {
+                break;
+            }
+        }
+    }
+    PerfCounters::Values step_values = counters.stop();
+    auto step_time = clock::now();
+
+    f = orig;
+    counters.start();
+    for (std::size_t i = 0; i != fields.size(); ++i) {
+        f.next(serials[i]);
+    }
+    PerfCounters::Values next_values = counters.stop();
+    auto next_time = clock::now();
+
+    unsigned int execute_ms = ms(start_time, execute_time);
+    unsigned int step_ms = ms(execute_time, step_time);
+    PerfCounters::Values loop_values;
+    for (int c = 0; c != PerfCounters::num_counters; ++c) {
+        loop_values.value[c] = execute_values.value[c] - std::min(execute_values.value[c], step_values.value[c]);
+    }
+    std::cout << N << "x" << N << ", " << fields.size() << " fields" << std::endl;
+    print_phase("Run::execute", execute_ms, counters, execute_values);
+    print_phase("  do_step", step_ms, counters, step_values);
+    print_phase("  detect_loop (difference)", execute_ms - std::min(execute_ms, step_ms), counters, loop_values);
+    print_phase("Field::next", ms(step_time, next_time), counters, next_values);
 }
 
+// fixed workload for profile guided optimization and the counter harness
+const unsigned long training_fields = 20000;
 
-int main()
+int main(int argc, char* argv[])
 {
     const int SIZE = 6;
-    if (!g_filename.empty()) {
+    if (argc > 1 && strcmp(argv[1], "--train") == 0) {
+        investigate<5>(training_fields);
+    }
+    else if (argc > 1 && strcmp(argv[1], "--counters") == 0) {
+        profile_phases<5>(training_fields);
+    }
+    else if (argc > 1 && strcmp(argv[1], "--verify") == 0) {
+        bool same = verify_staged_search<3>();
+        same = verify_staged_search<4>() && same;
+        same = verify_staged_search<5>() && same;
+        return same ? 0 : 1;
+    }
+    else if (!g_batch_path.empty()) {
+        run_batch(g_batch_path);
+    }
+    else if (!g_program_filename.empty()) {
+        run_program(g_program_filename, g_benchmark_program);
+    }
+    else if (!g_filename.empty()) {
         run_from_file<SIZE>(g_filename);
     }
     else {
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "field.h"
+#include "loader.h"
+#include "run.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * What a sweep needs from the run of one field
+ */
+template <int N>
+struct RunSummary
+{
+    typename Run<N>::Result result;
+    std::vector<int> serials;
+    int position;
+    int direction;
+};
+
+/**
+ * Results of the NxN sweep, written to a file sorted by field and searched
+ * in a memory mapping of it. An (N+1)x(N+1) field with only ' ' in its last
+ * row and column runs like its top left NxN part, except that leaving the
+ * board on the right or at the bottom takes one more step. Results are
+ * only valid for the step budget they were computed with.
+ */
+template <int N>
+class ResultCache
+{
+public:
+    explicit ResultCache(unsigned int max_steps) : m_max_steps{max_steps} {}
+
+    void add(Field<N> const& f, RunSummary<N> const& summary)
+    {
+        Record record{};
+        record.key = key(f);
+        record.steps = summary.result.steps;
+        record.type = static_cast<uint8_t>(summary.result.type);
+        record.loop_type = static_cast<uint8_t>(summary.result.loop_type);
+        record.position = summary.position;
+        record.direction = summary.direction;
+        record.num_serials = summary.serials.size();
+        std::copy(summary.serials.begin(), summary.serials.end(), record.serials);
+        m_new_records.push_back(record);
+    }
+
+    void save(std::string const& filename)
+    {
+        std::sort(m_new_records.begin(), m_new_records.end(), [](Record const& a, Record const& b) { return a.key < b.key; });
+        Header header{};
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.size = N;
+        header.record_size = sizeof(Record);
+        header.max_steps = m_max_steps;
+        header.count = m_new_records.size();
+        std::ofstream out(filename, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(m_new_records.data()), m_new_records.size()*sizeof(Record));
+        if (!out) {
+            throw std::runtime_error("cannot write " + filename);
+        }
+    }
+
+    void load(std::string const& filename)
+    {
+        m_file.reset(new MappedFile(filename));
+        Header header;
+        std::size_t size = m_file->end() - m_file->begin();
+        if (size < sizeof(header)) {
+            throw std::runtime_error(filename + ": not a result cache");
+        }
+        memcpy(&header, m_file->begin(), sizeof(header));
+        if (memcmp(header.magic, magic, sizeof(header.magic)) != 0 ||
+            header.size != N ||
+            header.record_size != sizeof(Record) ||
+            size != sizeof(header) + header.count*sizeof(Record)) {
+            throw std::runtime_error(filename + ": not a result cache of " + std::to_string(N) + "x" + std::to_string(N) + " fields");
+        }
+        if (header.max_steps != m_max_steps) {
+            throw std::runtime_error(filename + ": results for " + std::to_string(header.max_steps) + " steps, not " + std::to_string(m_max_steps));
+        }
+        m_records = reinterpret_cast<Record const*>(m_file->begin() + sizeof(header));
+        m_count = header.count;
+    }
+
+    bool loaded() const
+    {
+        return m_records != nullptr;
+    }
+
+    /**
+     * Sets 'summary' for the (N+1)x(N+1) field f from the cache. Returns false
+     * if f has no cached NxN counterpart, or if the extra step would reach the budget.
+     */
+    bool find_larger(Field<N+1> const& f, RunSummary<N+1>& summary) const
+    {
+        Field<N> small;
+        for (int y = 0; y != N+1; y++) {
+            for (int x = 0; x != N+1; x++) {
+                char c = f.get(Pos<N+1>(x, y));
+                if (x != N && y != N) {
+                    small.set(x, y, c);
+                }
+                else if (c != ' ') {
+                    return false;
+                }
+            }
+        }
+        Record const* record = find(key(small));
+        if (!record) {
+            return false;
+        }
+
+        auto larger = [](int s) { return s == N*N ? (N+1)*(N+1) : s%N + (s/N)*(N+1); };
+        summary.position = larger(record->position);
+        summary.direction = record->direction;
+        summary.serials.clear();
+        for (int i = 0; i != record->num_serials; ++i) {
+            summary.serials.push_back(larger(record->serials[i]));
+        }
+        unsigned int steps = record->steps;
+        if (record->type == static_cast<uint8_t>(Run<N>::ResultType::finite) && record->position != N*N) {
+            // the extra cell on the way out is read as well
+            int x = record->position % N;
+            int y = record->position / N;
+            if (record->direction == 1 /* right */) {
+                summary.position = y*(N+1) + N;
+            }
+            else if (record->direction == 2 /* down */) {
+                summary.position = N*(N+1) + x;
+            }
+            if (record->direction == 1 || record->direction == 2) {
+                if (++steps == m_max_steps) {
+                    return false;
+                }
+                summary.serials.push_back(summary.position);
+            }
+        }
+        summary.result = typename Run<N+1>::Result{static_cast<typename Run<N+1>::ResultType>(record->type), steps,
+                                                   static_cast<LoopDetectorType>(record->loop_type)};
+        return true;
+    }
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t size;
+        uint32_t record_size;
+        uint32_t max_steps;
+        uint64_t count;
+    };
+
+    struct Record
+    {
+        FieldCount key;
+        uint32_t steps;
+        uint8_t type;
+        uint8_t loop_type;
+        uint8_t position;
+        uint8_t direction;
+        uint8_t num_serials;
+        uint8_t serials[N*N];
+    };
+
+    // the cells as a base 3 number, with ' ', '*' and '+' as digits
+    static FieldCount key(Field<N> const& f)
+    {
+        FieldCount result = 0;
+        for (int s = 0; s != N*N; ++s) {
+            result = 3*result + (f.get(s) == '*' ? 1 : f.get(s) == '+' ? 2 : 0);
+        }
+        return result;
+    }
+
+    Record const* find(FieldCount key) const
+    {
+        Record const* end = m_records + m_count;
+        Record const* it = std::lower_bound(m_records, end, key, [](Record const& r, FieldCount k) { return r.key < k; });
+        return it != end && it->key == key ? it : nullptr;
+    }
+
+    static constexpr const char* magic = "2LCACHE";
+
+    unsigned int m_max_steps;
+    std::vector<Record> m_new_records;
+    std::unique_ptr<MappedFile> m_file;
+    Record const* m_records{nullptr};
+    std::size_t m_count{0};
+};
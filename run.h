@@ -1,6 +1,7 @@
 #pragma once
 
 #include "global.h"
+#include "core.h"
 #include "field.h"
 #include "state.h"
 #include <bitset>
@@ -13,19 +14,21 @@ private:
     Field<N> const* m_f;
     State<N> m_s;
     MainLoopDetector<N> m_loop_detector;
+    unsigned int m_step{0};
     unsigned int m_previous_state_step{0};
     unsigned int m_loop_detection_period{0};
     std::bitset<N*N> serial_used;
     std::vector<int> serials_used;
 
-    char get(Pos<N> p)
+    static const Geometry s_geometry;
+
+    char get(int s)
     {
-        int s = p.serial();
         if (!serial_used.test(s)) {
             serial_used.set(s);
             serials_used.push_back(s);
         }
-        return m_f->get(p);
+        return m_f->get(s);
     }
 
 public:
@@ -36,11 +39,37 @@ public:
     {
     }
 
+    /**
+     * Continue from the state of another run, of the same field
+     */
+    void copy_from(Run<N> const& other)
+    {
+        m_f = other.m_f;
+        m_s = other.m_s;
+        m_s.set_loop_detector(other.m_loop_detection_period ? &m_loop_detector : nullptr);
+        m_loop_detector.copy_from(other.m_loop_detector);
+        m_step = other.m_step;
+        m_previous_state_step = other.m_previous_state_step;
+        m_loop_detection_period = other.m_loop_detection_period;
+        serial_used = other.serial_used;
+        serials_used = other.serials_used;
+    }
+
+    /**
+     * Continue from the state of another run, with f a copy of its field
+     */
+    void copy_from(Run<N> const& other, Field<N> const& f)
+    {
+        copy_from(other);
+        m_f = &f;
+    }
+
     void reset(Field<N> const& f)
     {
         // note that the m_loop_detector is not reset
         m_f = &f;
         m_s.reset();
+        m_step = 0;
         m_previous_state_step = 0;
         m_loop_detection_period = 0;
         serial_used.reset();
@@ -64,73 +93,57 @@ public:
 
     void print_state(unsigned int steps)
     {
-        m_f->print(m_s.pos);
+        m_f->print(Pos<N>{m_s.pos%N, m_s.pos/N});
         m_s.print();
         fflush(stdout);
         printf("%d\n\n", steps);
         usleep(200000);
     }
 
-    enum class StepResult { ok, done, overflow };
+    // interface for do_2l_step()
+    char cell(int serial)
+    {
+        return get(serial);
+    }
+
+    bool mem_nonzero()
+    {
+        return m_s.get_mem() != 0;
+    }
 
-    StepResult do_step()
+    bool star(int d)
     {
-        while(true) {
-            Pos<N> next = m_s.pos;
-            bool out_of_bounds = false;
-            next.move(m_s.d, out_of_bounds);
-            if (out_of_bounds) {
-                return StepResult::done;
-            }
-            if (get(next) != '+') {
-                m_s.pos = next;
-                break;
-            }
-            if (m_s.get_mem()) {
-                m_s.d = (m_s.d+1)%4; // turn right
-            } else {
-                m_s.d = (m_s.d+3)%4; // turn left
-            }
+        if (star_move_mem_loc[d]) {
+            m_s.move_mem_loc(star_move_mem_loc[d]);
         }
-        if (get(m_s.pos) == '*') {
-            switch (m_s.d) {
-                case 0: /* up */
-                    m_s.decr_mem_loc();
-                    break;
-                case 1: /* right */
-                    m_s.incr_mem();
-                    break;
-                case 2: /* down */
-                    m_s.incr_mem_loc();
-                    break;
-                case 3: /* left */
-                    m_s.decr_mem();
-                    break;
-            }
-            if (m_s.memory_out_of_bounds())
-            {
-                return StepResult::overflow;
-            }
+        else {
+            m_s.add_mem(star_add_mem[d]);
         }
-        return StepResult::ok;
+        return !m_s.memory_out_of_bounds();
+    }
+
+    StepResult do_step()
+    {
+        return do_2l_step(s_geometry, m_s.pos, m_s.d, *this);
     }
 
-    bool detect_loop(unsigned int step)
+    LoopDetectorType detect_loop(unsigned int step)
     {
         const unsigned int start_detection_steps = 30;
         const unsigned int stop_detection_steps = 5000;
         if (step > stop_detection_steps) {
-            return false;
+            return LoopDetectorType::none;
         }
         if (step == start_detection_steps ||
             (m_loop_detection_period && step == m_previous_state_step + m_loop_detection_period)) {
-            if (m_loop_detection_period && m_loop_detector.detect_loop())
+            LoopDetectorType loop_type = m_loop_detection_period ? m_loop_detector.detect_loop() : LoopDetectorType::none;
+            if (loop_type != LoopDetectorType::none)
             {
                 if (debug_level != 0) {
                     std::cout << "Loop detected:" << std::endl;
                     m_f->print();
                 }
-                return true;
+                return loop_type;
             }
             m_s.set_loop_detector(&m_loop_detector);
             m_loop_detector.start();
@@ -140,20 +153,42 @@ public:
                 std::cout << "Setting loop detection period to " << m_loop_detection_period << std::endl;
             }
         }
-        return false;
+        return LoopDetectorType::none;
+    }
+
+    // undecided is not a final result: the run stopped at an undecided cell, see undecided_serial()
+    enum class ResultType { finite, infinite, error, undecided, LAST_VALUE=error };
+    static const char* result_type_name(ResultType type)
+    {
+        switch (type) {
+            case ResultType::finite:
+                return "finite";
+            case ResultType::infinite:
+                return "infinite";
+            case ResultType::error:
+                return "error";
+            case ResultType::undecided:
+                return "undecided";
+        }
+        return "";
     }
 
-    enum class ResultType { finite, infinite, error, LAST_VALUE=error };
     struct Result
     {
         ResultType type;
         unsigned int steps;
+        LoopDetectorType loop_type = LoopDetectorType::none;
     };
 
 
+    /**
+     * Runs until the result is known or max_steps steps have been done in total.
+     * After an undecided result, decide the cell and call execute again to continue.
+     */
     Result execute(unsigned int max_steps)
     {
-        for(unsigned int step = 0; step != max_steps; ++step) {
+        for(; m_step != max_steps; ++m_step) {
+            unsigned int step = m_step;
             StepResult step_result = do_step();
 
             if (debug_level != 0) {
@@ -168,15 +203,38 @@ public:
                     std::cout << "Overflow detected:" << std::endl;
                     m_f->print();
                 }
-                return Result{ResultType::error, 0};
+                return Result{ResultType::error, step};
+            }
+            else if (step_result == StepResult::undecided) {
+                return Result{ResultType::undecided, step};
             }
 
-            if (detect_loop(step)) {
-                return Result{ResultType::infinite, 0};
+            LoopDetectorType loop_type = detect_loop(step);
+            if (loop_type != LoopDetectorType::none) {
+                return Result{ResultType::infinite, step, loop_type};
             }
 
         }
-        return Result{ResultType::error, 0};
+        return Result{ResultType::error, max_steps};
+    }
+
+    /**
+     * The cell a run with an undecided result stopped at
+     */
+    int undecided_serial() const
+    {
+        return s_geometry.next(m_s.pos, m_s.d);
+    }
+
+    // serial and direction where the run ended
+    int position() const
+    {
+        return m_s.pos;
+    }
+
+    int direction() const
+    {
+        return m_s.d;
     }
 
     std::vector<int> const& get_serials_used() const
@@ -185,3 +243,5 @@ public:
     }
 };
 
+template <int N>
+const Geometry Run<N>::s_geometry{N, N, 1};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "lazy_search.h"
+#include "statistics.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/**
+ * Evaluation with a growing step budget. A depth-first search over all
+ * fields uses a small first budget; the runs it cannot resolve are queued
+ * for a pool of workers, which continue them from where they stopped with
+ * budgets that grow by a constant factor up to max_steps. The results are
+ * the same as with max_steps from the start.
+ */
+template <int N>
+class StagedSearch
+{
+public:
+    StagedSearch(unsigned int first_budget, unsigned int growth, unsigned int max_steps) :
+        m_max_steps{max_steps}
+    {
+        for (unsigned long b = first_budget; ; b *= growth) {
+            m_budgets.push_back(static_cast<unsigned int>(std::min<unsigned long>(b, max_steps)));
+            if (b >= max_steps) {
+                break;
+            }
+        }
+        m_stage_count.resize(m_budgets.size());
+    }
+
+    void run()
+    {
+        unsigned int num_workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i != num_workers; ++i) {
+            workers.emplace_back([this]() { work(); });
+        }
+
+        Shard shard(m_budgets.size());
+        LazySearch<N> search(m_budgets[0]);
+        search.run([&](typename Run<N>::Result result, Field<N> const& f, FieldCount weight, Run<N> const& r) {
+            if (unresolved(result, 0)) {
+                push(r, f, 0, true);
+            }
+            else {
+                shard.add(result, f, r, weight, 0);
+            }
+            return true;
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_search_done = true;
+        }
+        m_changed.notify_all();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+        merge(shard);
+    }
+
+    Statistics<N> const& statistics() const
+    {
+        return m_statistics.get();
+    }
+
+    void print_stages(std::ostream& os) const
+    {
+        for (std::size_t stage = 0; stage != m_budgets.size(); ++stage) {
+            os << "Stage " << stage << " (budget " << m_budgets[stage] << "): "
+               << "finite " << m_stage_count[stage][static_cast<int>(Run<N>::ResultType::finite)]
+               << ", infinite " << m_stage_count[stage][static_cast<int>(Run<N>::ResultType::infinite)]
+               << ", error " << m_stage_count[stage][static_cast<int>(Run<N>::ResultType::error)] << std::endl;
+        }
+    }
+
+private:
+    using StageCount = std::array<unsigned long, static_cast<int>(Run<N>::ResultType::LAST_VALUE)+1>;
+
+    // results of one thread
+    struct Shard
+    {
+        explicit Shard(std::size_t num_stages) : stage_count(num_stages, StageCount{}) {}
+
+        void add(typename Run<N>::Result result, Field<N> const& f, Run<N> const& r,
+                 FieldCount weight, std::size_t stage)
+        {
+            if (result.type == Run<N>::ResultType::undecided) {
+                return;
+            }
+            statistics.add_result(result, LazySearch<N>::complete(f), r.get_serials_used(), weight);
+            ++stage_count[stage][static_cast<int>(result.type)];
+        }
+
+        Statistics<N> statistics;
+        std::vector<StageCount> stage_count;
+    };
+
+    // a run that is continued with the budget of the next stage
+    struct Item
+    {
+        std::unique_ptr<Run<N>> run;
+        Field<N> field;
+        std::size_t stage;
+    };
+
+    bool unresolved(typename Run<N>::Result result, std::size_t stage) const
+    {
+        return result.type == Run<N>::ResultType::error &&
+               result.steps == m_budgets[stage] &&
+               stage+1 != m_budgets.size();
+    }
+
+    // the search waits while the queue is full; workers never wait to add their own items
+    void push(Run<N> const& r, Field<N> const& f, std::size_t stage, bool wait)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (wait) {
+            m_changed.wait(lock, [this]() { return m_queue.size() < max_queue_size; });
+        }
+        std::unique_ptr<Run<N>> run;
+        if (m_free_runs.empty()) {
+            run.reset(new Run<N>());
+        }
+        else {
+            run = std::move(m_free_runs.back());
+            m_free_runs.pop_back();
+        }
+        // the field pointer of the copy is set again when the run is continued
+        run->copy_from(r);
+        m_queue.push_back(Item{std::move(run), f, stage});
+        ++m_pending;
+        m_changed.notify_all();
+    }
+
+    void work()
+    {
+        Shard shard(m_budgets.size());
+        LazySearch<N> search(m_max_steps);
+        while (true) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return !m_queue.empty() || (m_search_done && m_pending == 0); });
+                if (m_queue.empty()) {
+                    break;
+                }
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            m_changed.notify_all();
+
+            const std::size_t stage = item.stage + 1;
+            search.set_max_steps(m_budgets[stage]);
+            search.run_from(*item.run, item.field, [&](typename Run<N>::Result result, Field<N> const& f, FieldCount weight, Run<N> const& r) {
+                if (unresolved(result, stage)) {
+                    push(r, f, stage, false);
+                }
+                else {
+                    shard.add(result, f, r, weight, stage);
+                }
+                return true;
+            });
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free_runs.push_back(std::move(item.run));
+                --m_pending;
+            }
+            m_changed.notify_all();
+        }
+        merge(shard);
+    }
+
+    void merge(Shard const& shard)
+    {
+        m_statistics.merge(shard.statistics);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::size_t stage = 0; stage != m_budgets.size(); ++stage) {
+            for (std::size_t t = 0; t != shard.stage_count[stage].size(); ++t) {
+                m_stage_count[stage][t] += shard.stage_count[stage][t];
+            }
+        }
+    }
+
+    static const std::size_t max_queue_size = 64;
+
+    unsigned int m_max_steps;
+    std::vector<unsigned int> m_budgets;
+    StatisticsCollector<N> m_statistics;
+    std::vector<StageCount> m_stage_count;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<Item> m_queue;
+    std::vector<std::unique_ptr<Run<N>>> m_free_runs;
+    unsigned long m_pending{0};
+    bool m_search_done{false};
+};
@@ -2,55 +2,114 @@
 
 #include "field.h"
 #include <array>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <vector>
 
 template <int N> class MainLoopDetector;
 
 /**
- * Array with efficient reset
+ * Array with efficient reset and copy: all non-zero values are within the used range.
+ * Values are stored as int8_t until one does not fit; the array then switches to int
+ * until the next clear().
  */
 template <int SZ>
 class TrackedArray
 {
 public:
-    using size_type = typename std::array<int, SZ>::size_type;
+    using size_type = std::uint16_t;
+    static_assert(SZ <= std::numeric_limits<size_type>::max(), "TrackedArray is too large for its size_type");
 
     TrackedArray() {
-        std::fill(data.begin(), data.end(), 0);
+        std::fill(narrow.begin(), narrow.end(), 0);
+    }
+
+    TrackedArray(TrackedArray<SZ> const& other) : TrackedArray() {
+        *this = other;
+    }
+
+    TrackedArray<SZ>& operator=(TrackedArray<SZ> const& other) {
+        if (this != &other) {
+            clear();
+            if (other.mmin_used <= other.mmax_used) {
+                if (other.is_wide) {
+                    promote();
+                    std::copy(other.wide.begin() + other.mmin_used, other.wide.begin() + other.mmax_used + 1, wide.begin() + other.mmin_used);
+                }
+                else {
+                    std::copy(other.narrow.begin() + other.mmin_used, other.narrow.begin() + other.mmax_used + 1, narrow.begin() + other.mmin_used);
+                }
+            }
+            mmin_used = other.mmin_used;
+            mmax_used = other.mmax_used;
+        }
+        return *this;
     }
 
     bool operator==(TrackedArray<SZ> const& other) const {
-        return data == other.data;
+        for (int n = 0; n != SZ; ++n) {
+            if (get(n) != other.get(n)) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    int& get_ref(size_type n) {
-        mmin_used = std::min(mmin_used, n);
-        mmax_used = std::max(mmax_used, n);
-        return data[n];
+    void add(size_type n, int delta) {
+        set(n, get(n) + delta);
     }
 
     int get(size_type n) const {
-        return data[n];
+        return is_wide ? wide[n] : narrow[n];
     }
 
     void set(size_type n, int value) {
         mmin_used = std::min(mmin_used, n);
         mmax_used = std::max(mmax_used, n);
-        data[n] = value;
+        if (!is_wide) {
+            if (value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max()) {
+                narrow[n] = value;
+                return;
+            }
+            promote();
+        }
+        wide[n] = value;
     }
 
     void clear()
     {
         if (mmin_used <= mmax_used)
         {
-            std::fill(data.begin() + mmin_used, data.begin() + mmax_used + 1, 0);
+            if (is_wide) {
+                std::fill(wide.begin() + mmin_used, wide.begin() + mmax_used + 1, 0);
+            }
+            else {
+                std::fill(narrow.begin() + mmin_used, narrow.begin() + mmax_used + 1, 0);
+            }
         }
+        is_wide = false;
         mmin_used = SZ;
         mmax_used = 0;
     }
 
 private:
-    std::array<int, SZ> data{};
+    // moves the used range to 'wide', leaving 'narrow' all zero
+    void promote()
+    {
+        if (wide.empty()) {
+            wide.resize(SZ, 0);
+        }
+        if (mmin_used <= mmax_used) {
+            std::copy(narrow.begin() + mmin_used, narrow.begin() + mmax_used + 1, wide.begin() + mmin_used);
+            std::fill(narrow.begin() + mmin_used, narrow.begin() + mmax_used + 1, 0);
+        }
+        is_wide = true;
+    }
+
+    std::array<int8_t, SZ> narrow{};
+    std::vector<int> wide;
+    bool is_wide = false;
     size_type mmin_used = SZ;
     size_type mmax_used = 0;
 };
@@ -61,21 +120,23 @@ class State
 public:
     const static int mem_size = 30000;
 
+    using mem_loc_type = typename TrackedArray<mem_size>::size_type;
+
 private:
-    std::array<int, mem_size>::size_type m_min_mloc{0};
-    std::array<int, mem_size>::size_type m_max_mloc{0};
+    mem_loc_type m_min_mloc{0};
+    mem_loc_type m_max_mloc{0};
     MainLoopDetector<N>* m_loop_detector{nullptr};
 
 public:
 
     TrackedArray<mem_size> mbuf;
-    TrackedArray<mem_size>::size_type mloc{0};
-    Pos<N> pos{-1, 0};
+    mem_loc_type mloc{0};
+    int pos = N*N; // serial; starts at the entry cell left of (0, 0)
     int d = 1;
 
     void reset()
     {
-        pos = Pos<N>{-1, 0};
+        pos = N*N;
         d = 1;
         mbuf.clear();
         mloc = mem_size/2;
@@ -102,29 +163,18 @@ public:
         return mbuf.get(mloc);
     }
 
-    void incr_mem()
-    {
-        mem_used();
-        ++mbuf.get_ref(mloc);
-    }
-
-    void decr_mem()
+    void add_mem(int delta)
     {
         mem_used();
-        --mbuf.get_ref(mloc);
+        mbuf.add(mloc, delta);
     }
 
-    void incr_mem_loc()
+    void move_mem_loc(int delta)
     {
-        ++mloc;
+        mloc += delta;
         if ( mloc > m_max_mloc ) {
             m_max_mloc = mloc;
         }
-    }
-
-    void decr_mem_loc()
-    {
-        --mloc;
         if ( mloc < m_min_mloc ) {
             m_min_mloc = mloc;
         }
@@ -167,7 +217,7 @@ class IdenticalMemoryLoopDetector
 private:
     State<N> const& m_s;
     State<N> m_original;
-    using mem_loc_type = typename std::array<int, State<N>::mem_size>::size_type;
+    using mem_loc_type = typename State<N>::mem_loc_type;
     mem_loc_type m_min_mloc{0};
     mem_loc_type m_max_mloc{0};
 
@@ -195,6 +245,12 @@ public:
         m_original = m_s;
     }
 
+    void copy_from(IdenticalMemoryLoopDetector<N> const& other) {
+        m_original = other.m_original;
+        m_min_mloc = other.m_min_mloc;
+        m_max_mloc = other.m_max_mloc;
+    }
+
     void mem_used() {
         m_max_mloc = std::max(m_max_mloc, m_s.mloc);
         m_min_mloc = std::min(m_min_mloc, m_s.mloc);
@@ -213,7 +269,7 @@ class GrowingMemoryLoopDetector
 private:
     State<N> const& m_s;
     State<N> m_original;
-    using mem_loc_type = typename std::array<int, State<N>::mem_size>::size_type;
+    using mem_loc_type = typename State<N>::mem_loc_type;
     mem_loc_type m_min_mloc{0};
     mem_loc_type m_max_mloc{0};
     bool m_mem_was_zero;
@@ -257,6 +313,13 @@ public:
         m_mem_was_zero = false;
     }
 
+    void copy_from(GrowingMemoryLoopDetector<N> const& other) {
+        m_original = other.m_original;
+        m_min_mloc = other.m_min_mloc;
+        m_max_mloc = other.m_max_mloc;
+        m_mem_was_zero = other.m_mem_was_zero;
+    }
+
     void mem_used() {
         m_max_mloc = std::max(m_max_mloc, m_s.mloc);
         m_min_mloc = std::min(m_min_mloc, m_s.mloc);
@@ -269,6 +332,8 @@ public:
     }
 };
 
+enum class LoopDetectorType { none, identical_memory, growing_memory, LAST_VALUE=growing_memory };
+
 template <int N>
 class MainLoopDetector
 {
@@ -283,14 +348,14 @@ public:
     {
     }
 
-    bool detect_loop() const {
+    LoopDetectorType detect_loop() const {
         if (m_loop_detector_1.detect_loop()) {
-            return true;
+            return LoopDetectorType::identical_memory;
         }
         if (m_loop_detector_2.detect_loop()) {
-            return true;
+            return LoopDetectorType::growing_memory;
         }
-        return false;
+        return LoopDetectorType::none;
     }
 
     void start() {
@@ -298,6 +363,11 @@ public:
         m_loop_detector_2.start();
     }
 
+    void copy_from(MainLoopDetector<N> const& other) {
+        m_loop_detector_1.copy_from(other.m_loop_detector_1);
+        m_loop_detector_2.copy_from(other.m_loop_detector_2);
+    }
+
     void mem_used() {
         m_loop_detector_1.mem_used();
         m_loop_detector_2.mem_used();
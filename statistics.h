@@ -0,0 +1,289 @@
+#pragma once
+
+#include "field.h"
+#include "run.h"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * Histogram of step counts with power-of-two buckets: bucket b holds [2^b - 1, 2^(b+1) - 1)
+ */
+class StepHistogram
+{
+public:
+    static const int num_buckets = 33;
+
+    void add(unsigned int steps)
+    {
+        int b = 0;
+        for (unsigned long v = static_cast<unsigned long>(steps) + 1; v > 1; v >>= 1) {
+            ++b;
+        }
+        ++m_count[b];
+    }
+
+    void merge(StepHistogram const& other)
+    {
+        for (int b = 0; b != num_buckets; ++b) {
+            m_count[b] += other.m_count[b];
+        }
+    }
+
+    void print(std::ostream& os) const
+    {
+        for (int b = 0; b != num_buckets; ++b) {
+            if (m_count[b]) {
+                os << "  [" << (1ul << b) - 1 << ", " << (1ul << (b+1)) - 1 << "): " << m_count[b] << std::endl;
+            }
+        }
+    }
+
+private:
+    std::array<unsigned long, num_buckets> m_count{};
+};
+
+/**
+ * Hash of a set of (field, result type, steps) tuples: the sum of a hash of
+ * each, so that it can be computed in parts and merged in any order.
+ */
+class ResultChecksum
+{
+public:
+    void add(FieldCount key, int type, unsigned int steps)
+    {
+        unsigned long h = mix((static_cast<unsigned long>(type) << 32) | steps);
+        h = mix(static_cast<unsigned long>(key >> 64) ^ h);
+        m_sum += mix(static_cast<unsigned long>(key) ^ h);
+    }
+
+    void merge(ResultChecksum const& other)
+    {
+        m_sum += other.m_sum;
+    }
+
+    unsigned long value() const
+    {
+        return m_sum;
+    }
+
+private:
+    // splitmix64 finalizer
+    static unsigned long mix(unsigned long x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ul;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebul;
+        return x ^ (x >> 31);
+    }
+
+    unsigned long m_sum{0};
+};
+
+/**
+ * Result counts, step histograms and a leaderboard of the longest finite fields.
+ * Not thread safe: use one instance per thread and merge() them afterwards;
+ * the merged statistics do not depend on how the fields were divided.
+ */
+template <int N>
+class Statistics
+{
+public:
+    struct Entry
+    {
+        unsigned int steps;
+        FieldCount key;
+        Field<N> field;
+    };
+
+    explicit Statistics(std::size_t top_k = 10) : m_top_k{top_k} {}
+
+    // undecided is not a final result and is not counted
+    void add_result(typename Run<N>::Result result)
+    {
+        if (result.type == Run<N>::ResultType::undecided) {
+            return;
+        }
+        ++m_result_count[static_cast<int>(result.type)];
+        switch (result.type) {
+            case Run<N>::ResultType::finite:
+                m_finite_steps.add(result.steps);
+                break;
+            case Run<N>::ResultType::infinite:
+                ++m_loop_count[static_cast<int>(result.loop_type)];
+                break;
+            case Run<N>::ResultType::error:
+                m_error_steps.add(result.steps);
+                break;
+            case Run<N>::ResultType::undecided:
+                break;
+        }
+    }
+
+    /**
+     * 'serials_used' are the cells enumerated for f, see Field<N>::enumeration_key(),
+     * and 'weight' is the number of complete fields this result stands for
+     */
+    void add_result(typename Run<N>::Result result, Field<N> const& f, std::vector<int> const& serials_used,
+                    FieldCount weight)
+    {
+        if (result.type == Run<N>::ResultType::undecided) {
+            return;
+        }
+        add_result(result);
+        m_weighted_count[static_cast<int>(result.type)] += weight;
+        FieldCount key = f.enumeration_key(serials_used);
+        m_checksum.add(key, static_cast<int>(result.type), result.steps);
+        if (result.type == Run<N>::ResultType::finite) {
+            add_to_top(Entry{result.steps, key, f});
+        }
+    }
+
+    void merge(Statistics<N> const& other)
+    {
+        for (std::size_t i = 0; i != m_result_count.size(); ++i) {
+            m_result_count[i] += other.m_result_count[i];
+        }
+        for (std::size_t i = 0; i != m_weighted_count.size(); ++i) {
+            m_weighted_count[i] += other.m_weighted_count[i];
+        }
+        for (std::size_t i = 0; i != m_loop_count.size(); ++i) {
+            m_loop_count[i] += other.m_loop_count[i];
+        }
+        m_finite_steps.merge(other.m_finite_steps);
+        m_error_steps.merge(other.m_error_steps);
+        m_checksum.merge(other.m_checksum);
+        for (Entry const& e : other.m_top) {
+            add_to_top(e);
+        }
+    }
+
+    unsigned long count(typename Run<N>::ResultType type) const
+    {
+        return m_result_count[static_cast<int>(type)];
+    }
+
+    unsigned long total_count() const
+    {
+        unsigned long total = 0;
+        for (unsigned long c : m_result_count) {
+            total += c;
+        }
+        return total;
+    }
+
+    unsigned int max_steps() const
+    {
+        unsigned int result = 0;
+        for (Entry const& e : m_top) {
+            result = std::max(result, e.steps);
+        }
+        return result;
+    }
+
+    unsigned long checksum() const
+    {
+        return m_checksum.value();
+    }
+
+    /**
+     * The longest finite fields, longest first; equal step counts in enumeration order
+     */
+    std::vector<Entry> top() const
+    {
+        std::vector<Entry> result = m_top;
+        std::sort(result.begin(), result.end(), better);
+        return result;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "Statistics:" << std::endl;
+        os << "finite: " << count(Run<N>::ResultType::finite) << std::endl;
+        os << "infinite: " << count(Run<N>::ResultType::infinite) << std::endl;
+        os << "  identical memory: " << m_loop_count[static_cast<int>(LoopDetectorType::identical_memory)] << std::endl;
+        os << "  growing memory: " << m_loop_count[static_cast<int>(LoopDetectorType::growing_memory)] << std::endl;
+        os << "error: " << count(Run<N>::ResultType::error) << std::endl;
+        os << "Complete fields represented: finite " << count_to_string(m_weighted_count[static_cast<int>(Run<N>::ResultType::finite)])
+           << ", infinite " << count_to_string(m_weighted_count[static_cast<int>(Run<N>::ResultType::infinite)])
+           << ", error " << count_to_string(m_weighted_count[static_cast<int>(Run<N>::ResultType::error)]) << std::endl;
+        os << "Steps of finite fields:" << std::endl;
+        m_finite_steps.print(os);
+        os << "Steps of failed fields:" << std::endl;
+        m_error_steps.print(os);
+        os << "Checksum: " << std::hex << std::setw(16) << std::setfill('0') << checksum()
+           << std::dec << std::setfill(' ') << std::endl;
+    }
+
+    void print_top(std::ostream& os) const
+    {
+        std::vector<Entry> entries = top();
+        os << "Top " << entries.size() << " fields:" << std::endl;
+        for (Entry const& e : entries) {
+            os << e.steps << " steps" << std::endl;
+            e.field.print();
+        }
+    }
+
+private:
+    static bool better(Entry const& a, Entry const& b)
+    {
+        return a.steps != b.steps ? a.steps > b.steps : a.key < b.key;
+    }
+
+    // m_top is a heap with the worst entry in front
+    void add_to_top(Entry const& e)
+    {
+        if (m_top.size() >= m_top_k && e.steps < m_top.front().steps) {
+            return;
+        }
+        m_top.push_back(e);
+        std::push_heap(m_top.begin(), m_top.end(), better);
+        if (m_top.size() <= m_top_k) {
+            return;
+        }
+        // drop the lowest step count, but only if enough entries remain: ties are kept
+        unsigned int lowest = m_top.front().steps;
+        auto it = std::partition(m_top.begin(), m_top.end(), [lowest](Entry const& x) { return x.steps != lowest; });
+        if (static_cast<std::size_t>(it - m_top.begin()) >= m_top_k) {
+            m_top.erase(it, m_top.end());
+        }
+        std::make_heap(m_top.begin(), m_top.end(), better);
+    }
+
+    std::size_t m_top_k;
+    std::array<unsigned long, static_cast<int>(Run<N>::ResultType::LAST_VALUE)+1> m_result_count{};
+    std::array<FieldCount, static_cast<int>(Run<N>::ResultType::LAST_VALUE)+1> m_weighted_count{};
+    std::array<unsigned long, static_cast<int>(LoopDetectorType::LAST_VALUE)+1> m_loop_count{};
+    StepHistogram m_finite_steps;
+    StepHistogram m_error_steps;
+    ResultChecksum m_checksum;
+    std::vector<Entry> m_top;
+};
+
+/**
+ * Thread safe collection point for per-thread Statistics
+ */
+template <int N>
+class StatisticsCollector
+{
+public:
+    explicit StatisticsCollector(std::size_t top_k = 10) : m_statistics{top_k} {}
+
+    void merge(Statistics<N> const& shard)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.merge(shard);
+    }
+
+    Statistics<N> const& get() const
+    {
+        return m_statistics;
+    }
+
+private:
+    std::mutex m_mutex;
+    Statistics<N> m_statistics;
+};